@@ -0,0 +1,218 @@
+/*
+ Benchmark for the markdown parser library. Renders small documents in memory and compares this with the file based path taken by the command line tool (read the source file, write a .htm file).
+ 
+ Usage: bench [iterations] [path to markdown executable]
+        bench -s file1.md [file2.md ...]
+        bench -l [large.md]
+ 
+ The -s form renders a corpus of documents with each inline markup mode and reports the total output size. The -l form compares rendering a large document in full with rendering previews of it.
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "markdown.h"
+
+static const char *smallDocument =
+    "@@ Release notes\n"
+    "# Version 1.2\n"
+    "Fixed a **crash** when opening *empty* files and ~~removed~~ the old `--legacy` switch.\n"
+    "See the [-changelog-](changes.htm) for details.\n"
+    "\n"
+    "- Faster start up\n"
+    "- Smaller output\n";
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+int CountBytes(const char *data, size_t length, void *userData)
+{
+    *(size_t *)userData += length;
+    return 0;
+}
+
+/*
+ SizeBenchmark() renders every file given with each markup mode and totals the size of the HTML produced.
+ */
+int SizeBenchmark(int fileCount, const char *fileNames[])
+{
+    const char *modeNames[] = {"inline styles", "class only", "semantic"};
+    size_t totals[3] = {0, 0, 0}, sourceTotal = 0;
+    markdown_options options = markdown_options();
+    std::string buffer;
+    
+    for (int i=0; i<fileCount; ++i) {
+        char chunk[4096];
+        size_t bytesRead;
+        std::vector<char> source;
+        FILE *markdownFile = fopen(fileNames[i], "r");
+        
+        if (!markdownFile) {
+            std::cerr << "Error opening " << fileNames[i] << " for reading\n";
+            continue;
+        }
+        while ((bytesRead=fread(chunk, 1, sizeof(chunk), markdownFile))>0)
+            source.insert(source.end(), chunk, chunk+bytesRead);
+        fclose(markdownFile);
+        sourceTotal += source.size();
+        
+        for (int mode=markupInline; mode<=markupSemantic; ++mode) {
+            options.markup = mode;
+            buffer.clear();
+            RenderToBuffer(source.empty()?"":&source[0], source.size(), &options, &buffer);
+            totals[mode] += buffer.size();
+        }
+    }
+    
+    std::cout << fileCount << " documents, " << sourceTotal << " bytes of markdown\n";
+    for (int mode=markupInline; mode<=markupSemantic; ++mode)
+        std::cout << "  " << modeNames[mode] << ": " << totals[mode] << " bytes (" << (totals[markupInline]?100.0*totals[mode]/totals[markupInline]:0) << "%)\n";
+    return 0;
+}
+
+/*
+ PreviewBenchmark() times a full render of a large document against previews limited by blocks and by bytes. Without a file a document of 100000 entries is generated.
+ */
+int PreviewBenchmark(const char *fileName)
+{
+    std::string source, buffer;
+    markdown_options options = markdown_options();
+    std::chrono::steady_clock::time_point start;
+    const int previewIterations = 10000;
+    double full;
+    
+    if (fileName) {
+        char chunk[4096];
+        size_t bytesRead;
+        FILE *markdownFile = fopen(fileName, "r");
+        
+        if (!markdownFile) {
+            std::cerr << "Error opening " << fileName << " for reading\n";
+            return 1;
+        }
+        while ((bytesRead=fread(chunk, 1, sizeof(chunk), markdownFile))>0)
+            source.append(chunk, bytesRead);
+        fclose(markdownFile);
+    }
+    else {
+        source = "@@ Large document\n";
+        for (int i=0; i<100000; ++i) {
+            source += "## Entry\nSome **bold** and *italic* text with a [-link-](page.htm) in it.\n";
+            source += "- first point\n- second point\n\n";
+        }
+    }
+    
+    start = std::chrono::steady_clock::now();
+    RenderToBuffer(source.data(), source.size(), &options, &buffer);
+    full = Seconds(start);
+    std::cout << "Large document (" << source.size() << " bytes in, " << buffer.size() << " bytes out)\n";
+    std::cout << "  full render:       " << full*1e3 << " ms\n";
+    
+    options.maxBlocks = 5;
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<previewIterations; ++i) {
+        buffer.clear();
+        RenderToBuffer(source.data(), source.size(), &options, &buffer);
+    }
+    std::cout << "  first 5 blocks:    " << Seconds(start)*1e6/previewIterations << " us (" << buffer.size() << " bytes out)\n";
+    
+    options.maxBlocks = 0;
+    options.maxBytes = 1024;
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<previewIterations; ++i) {
+        buffer.clear();
+        RenderToBuffer(source.data(), source.size(), &options, &buffer);
+    }
+    std::cout << "  first 1024 bytes:  " << Seconds(start)*1e6/previewIterations << " us (" << buffer.size() << " bytes out)\n";
+    return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc>1 && !strcmp(argv[1], "-s"))
+        return SizeBenchmark(argc-2, argv+2);
+    if (argc>1 && !strcmp(argv[1], "-l"))
+        return PreviewBenchmark(argc>2?argv[2]:NULL);
+    
+    int iterations = argc>1?atoi(argv[1]):100000;
+    size_t length = strlen(smallDocument);
+    size_t written = 0;
+    const char *styles[] = {"style.css"};
+    markdown_options options = markdown_options();
+    std::string buffer;
+    std::chrono::steady_clock::time_point start;
+    double inMemory, callback, fileBased;
+    
+    options.styles = styles;
+    options.styleCount = 1;
+    
+    //Render into a reused growable buffer.
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<iterations; ++i) {
+        buffer.clear();
+        RenderToBuffer(smallDocument, length, &options, &buffer);
+    }
+    inMemory = Seconds(start);
+    
+    //Render through a chunked write callback.
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<iterations; ++i)
+        RenderToCallback(smallDocument, length, &options, CountBytes, &written);
+    callback = Seconds(start);
+    
+    //Do what the command line tool does: read the source file and write a .htm file for every document.
+    FILE *f = fopen("bench_input.md", "w");
+    if (!f) {
+        std::cerr << "Error opening bench_input.md for writing\n";
+        return 1;
+    }
+    fputs(smallDocument, f);
+    fclose(f);
+    
+    start = std::chrono::steady_clock::now();
+    for (int i=0; i<iterations; ++i) {
+        char source[4096];
+        size_t sourceLength;
+        FILE *markdownFile = fopen("bench_input.md", "r"), *outFile;
+        
+        sourceLength = fread(source, 1, sizeof(source), markdownFile);
+        fclose(markdownFile);
+        outFile = fopen("bench_input.htm", "w");
+        RenderToFile(source, sourceLength, &options, outFile);
+        fclose(outFile);
+    }
+    fileBased = Seconds(start);
+    
+    std::cout << "Small document (" << length << " bytes in, " << buffer.size() << " bytes out), " << iterations << " iterations\n";
+    std::cout << "  in-memory buffer:  " << inMemory*1e6/iterations << " us/doc\n";
+    std::cout << "  write callback:    " << callback*1e6/iterations << " us/doc\n";
+    std::cout << "  file to file:      " << fileBased*1e6/iterations << " us/doc\n";
+    
+    //Optionally time the command line tool itself, which adds process start up.
+    if (argc>2) {
+        int runs = iterations<200?iterations:200;
+        std::string command = std::string(argv[2])+" bench_input.md style.css";
+        
+        start = std::chrono::steady_clock::now();
+        for (int i=0; i<runs; ++i) {
+            if (system(command.c_str())) {
+                std::cerr << "Error running " << command << "\n";
+                break;
+            }
+        }
+        std::cout << "  command line tool: " << Seconds(start)*1e6/runs << " us/doc (" << runs << " runs)\n";
+    }
+    
+    remove("bench_input.md");
+    remove("bench_input.htm");
+    
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ Reading and writing of document bundles, and conversion of a bundle of markdown documents into a bundle of HTML pages on several threads.
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include "bundle.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Number of documents in a batch. Two batches of rendered pages are held at a time, one being written while the next is rendered.
+static const size_t bundleBatchSize = 4096;
+static const char bundleMagic[] = "MDBUNDL1";
+
+namespace {
+
+//State shared by the threads of RenderBundle(). Page n is rendered into pages[n%(2*bundleBatchSize)].
+struct bundle_job {
+    const bundle_reader *input;
+    const markdown_options *options;
+    std::vector<std::string> pages;
+    std::atomic<size_t> next;
+    std::mutex lock;
+    std::condition_variable batchRendered, batchWritten;
+    size_t rendered[2];         //Pages finished in each half of pages.
+    size_t written;             //Pages written to the output bundle so far.
+    int failed;
+};
+
+}
+
+static unsigned long long ReadNumber(const char *p);
+static void WriteNumber(char *p, unsigned long long n);
+static void RenderWorker(bundle_job *job);
+static int MapBundle(const char *fileName, bundle_reader *bundle);
+static int ReadBundle(const char *fileName, bundle_reader *bundle);
+static void PageName(const char *name, size_t nameLength, std::string *pageName);
+
+/*
+ OpenBundle() maps a bundle into memory, or reads it in where mapping is not available, and checks its header.
+ */
+int OpenBundle(const char *fileName, bundle_reader *bundle)
+{
+    bundle->data = NULL;
+    bundle->size = 0;
+    bundle->count = 0;
+    bundle->mapping = NULL;
+    bundle->contents.clear();
+    
+    if (MapBundle(fileName, bundle) && ReadBundle(fileName, bundle))
+        return 1;
+    
+    if (bundle->size<16 || memcmp(bundle->data, bundleMagic, 8)) {
+        FreeBundle(bundle);
+        return 1;
+    }
+    bundle->count = (size_t)ReadNumber(bundle->data+8);
+    if (bundle->count>(bundle->size-16)/24) {
+        FreeBundle(bundle);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ GetBundleEntry() looks up entry n through the index, checking that it lies within the bundle.
+ */
+int GetBundleEntry(const bundle_reader *bundle, size_t n, bundle_entry *entry)
+{
+    const char *p;
+    unsigned long long offset, nameLength, length, size = bundle->size;
+    
+    if (n>=bundle->count)
+        return 1;
+    
+    p = bundle->data+16+24*n;
+    offset = ReadNumber(p);
+    nameLength = ReadNumber(p+8);
+    length = ReadNumber(p+16);
+    if (offset>size || nameLength>size-offset || length>size-offset-nameLength)
+        return 1;
+    
+    entry->name = bundle->data+offset;
+    entry->nameLength = (size_t)nameLength;
+    entry->data = entry->name+nameLength;
+    entry->length = (size_t)length;
+    return 0;
+}
+
+void FreeBundle(bundle_reader *bundle)
+{
+#ifndef _WIN32
+    if (bundle->mapping)
+        munmap(bundle->mapping, bundle->size);
+#endif
+    bundle->mapping = NULL;
+    bundle->data = NULL;
+    bundle->size = bundle->count = 0;
+    std::vector<char>().swap(bundle->contents);
+}
+
+/*
+ MapBundle() maps the whole file read only. It fails on systems without mmap() and for empty files.
+ */
+int MapBundle(const char *fileName, bundle_reader *bundle)
+{
+#ifndef _WIN32
+    struct stat info;
+    void *p;
+    int fd;
+    
+    if ((fd=open(fileName, O_RDONLY))<0)
+        return 1;
+    if (fstat(fd, &info) || info.st_size<=0) {
+        close(fd);
+        return 1;
+    }
+    p = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p==MAP_FAILED)
+        return 1;
+    
+    bundle->mapping = p;
+    bundle->data = (const char *)p;
+    bundle->size = (size_t)info.st_size;
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+/*
+ ReadBundle() reads the whole file into memory in one go.
+ */
+int ReadBundle(const char *fileName, bundle_reader *bundle)
+{
+    FILE *f;
+    long size;
+    
+    if ((f=fopen(fileName, "rb"))==NULL)
+        return 1;
+    
+    //Find the size of the file and read it in one go.
+    if (fseek(f, 0, SEEK_END) || (size=ftell(f))<0 || fseek(f, 0, SEEK_SET)) {
+        fclose(f);
+        return 1;
+    }
+    bundle->contents.resize((size_t)size);
+    if (size && fread(&bundle->contents[0], 1, (size_t)size, f)!=(size_t)size) {
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    
+    bundle->data = size?&bundle->contents[0]:"";
+    bundle->size = (size_t)size;
+    return 0;
+}
+
+/*
+ CreateBundle() writes the header of a new bundle and leaves room for the index of count entries, which is filled in by CloseBundle().
+ */
+int CreateBundle(const char *fileName, size_t count, bundle_writer *bundle)
+{
+    char header[16];
+    
+    if ((bundle->f=fopen(fileName, "wb"))==NULL)
+        return 1;
+    
+    memcpy(header, bundleMagic, 8);
+    WriteNumber(header+8, count);
+    
+    bundle->count = count;
+    bundle->position = 16+24*count;
+    bundle->index.clear();
+    bundle->index.reserve(3*count);
+    bundle->failed = fwrite(header, 1, sizeof(header), bundle->f)!=sizeof(header) || fseek(bundle->f, (long)bundle->position, SEEK_SET);
+    
+    //Do not leave a bundle behind that has a header but no index.
+    if (bundle->failed) {
+        fclose(bundle->f);
+        remove(fileName);
+    }
+    return bundle->failed;
+}
+
+int AddToBundle(bundle_writer *bundle, const char *name, size_t nameLength, const char *data, size_t length)
+{
+    if (bundle->failed || bundle->index.size()>=3*bundle->count)
+        return bundle->failed = 1;
+    
+    bundle->index.push_back(bundle->position);
+    bundle->index.push_back(nameLength);
+    bundle->index.push_back(length);
+    
+    if (fwrite(name, 1, nameLength, bundle->f)!=nameLength || fwrite(data, 1, length, bundle->f)!=length)
+        bundle->failed = 1;
+    bundle->position += nameLength+length;
+    
+    return bundle->failed;
+}
+
+/*
+ CloseBundle() writes the index behind the header and closes the file. It fails if fewer entries were added than the bundle was created for.
+ */
+int CloseBundle(bundle_writer *bundle)
+{
+    std::vector<char> index(8*bundle->index.size());
+    
+    for (size_t i=0; i<bundle->index.size(); ++i)
+        WriteNumber(&index[8*i], bundle->index[i]);
+    
+    if (bundle->index.size()!=3*bundle->count)
+        bundle->failed = 1;
+    if (!bundle->failed && !index.empty() && (fseek(bundle->f, 16, SEEK_SET) || fwrite(&index[0], 1, index.size(), bundle->f)!=index.size()))
+        bundle->failed = 1;
+    if (fclose(bundle->f))
+        bundle->failed = 1;
+    
+    return bundle->failed;
+}
+
+/*
+ RenderBundle() renders the documents on a pool of worker threads while the calling thread writes the finished pages out in order, a batch at a time.
+ */
+int RenderBundle(const bundle_reader *input, const char *outputName, const markdown_options *options, int threads)
+{
+    bundle_writer output;
+    bundle_entry entry;
+    markdown_options quiet = *options;
+    bundle_job job;
+    std::vector<std::thread> workers;
+    std::string pageName;
+    int failed = 0;
+    
+    if (threads<=0)
+        threads = (int)std::thread::hardware_concurrency();
+    if (threads<=0)
+        threads = 1;
+    
+    //Reporting stylesheets for every document would only interleave messages from the threads.
+    quiet.verbose = 0;
+    
+    if (CreateBundle(outputName, input->count, &output))
+        return 1;
+    
+    job.input = input;
+    job.options = &quiet;
+    job.pages.resize(2*bundleBatchSize);
+    job.next = 0;
+    job.rendered[0] = job.rendered[1] = 0;
+    job.written = 0;
+    job.failed = 0;
+    for (int i=0; i<threads; ++i)
+        workers.push_back(std::thread(RenderWorker, &job));
+    
+    for (size_t batchStart=0; batchStart<input->count && !failed; batchStart+=bundleBatchSize) {
+        size_t batchEnd = batchStart+bundleBatchSize<input->count?batchStart+bundleBatchSize:input->count;
+        size_t half = (batchStart/bundleBatchSize)%2;
+        
+        //Wait for the whole batch to be rendered.
+        {
+            std::unique_lock<std::mutex> guard(job.lock);
+            while (!job.failed && job.rendered[half]<batchEnd-batchStart)
+                job.batchRendered.wait(guard);
+            failed = job.failed;
+            job.rendered[half] = 0;
+        }
+        
+        for (size_t i=batchStart; i<batchEnd && !failed; ++i) {
+            const std::string &page = job.pages[i%(2*bundleBatchSize)];
+            
+            if (GetBundleEntry(input, i, &entry)) {
+                failed = 1;
+                break;
+            }
+            PageName(entry.name, entry.nameLength, &pageName);
+            if (AddToBundle(&output, pageName.data(), pageName.size(), page.data(), page.size()))
+                failed = 1;
+        }
+        
+        //Hand the pages of this batch back to the workers, or stop them if anything failed.
+        {
+            std::lock_guard<std::mutex> guard(job.lock);
+            job.written = batchEnd;
+            job.failed |= failed;
+        }
+        job.batchWritten.notify_all();
+    }
+    
+    for (size_t i=0; i<workers.size(); ++i)
+        workers[i].join();
+    
+    if (CloseBundle(&output) || job.failed)
+        failed = 1;
+    
+    //A failed bundle still has a valid header, so remove it rather than leave a bundle of empty pages.
+    if (failed)
+        remove(outputName);
+    return failed;
+}
+
+/*
+ RenderWorker() renders documents in order of a shared counter. Before reusing a page it waits for the batch that used it last to be written.
+ */
+void RenderWorker(bundle_job *job)
+{
+    bundle_entry entry;
+    size_t n;
+    
+    while ((n=job->next++)<job->input->count) {
+        size_t batch = n/bundleBatchSize;
+        std::string &page = job->pages[n%(2*bundleBatchSize)];
+        int failed;
+        
+        {
+            std::unique_lock<std::mutex> guard(job->lock);
+            while (!job->failed && batch>=2 && job->written<(batch-1)*bundleBatchSize)
+                job->batchWritten.wait(guard);
+            if (job->failed)
+                return;
+        }
+        
+        page.clear();
+        failed = GetBundleEntry(job->input, n, &entry) || RenderToBuffer(entry.data, entry.length, job->options, &page);
+        
+        {
+            std::lock_guard<std::mutex> guard(job->lock);
+            job->failed |= failed;
+            ++job->rendered[batch%2];
+        }
+        job->batchRendered.notify_one();
+    }
+}
+
+/*
+ PageName() names a page after its document, replacing the extension of the file name with .htm as the command line tool does.
+ */
+void PageName(const char *name, size_t nameLength, std::string *pageName)
+{
+    size_t end = nameLength;
+    
+    for (size_t i=nameLength; i>0 && name[i-1]!='/'; --i) {
+        if (name[i-1]=='.') {
+            end = i-1;
+            break;
+        }
+    }
+    pageName->assign(name, end);
+    pageName->append(".htm");
+}
+
+unsigned long long ReadNumber(const char *p)
+{
+    unsigned long long n = 0;
+    
+    for (int i=7; i>=0; --i)
+        n = n<<8|(unsigned char)p[i];
+    return n;
+}
+
+void WriteNumber(char *p, unsigned long long n)
+{
+    for (int i=0; i<8; ++i)
+        p[i] = (char)(n>>(8*i));
+}
@@ -0,0 +1,58 @@
+/*
+ bundle.h declares a simple indexed container holding many small documents in one file, and the conversion of a whole bundle of markdown documents into a bundle of HTML pages.
+ 
+ Layout of a bundle (all integers are 64 bit little endian):
+     "MDBUNDL1"                                     magic
+     count                                          number of entries
+     count x {offset, nameLength, length}           index, entry i starts at byte 16+24*i
+     entries                                        each is the name followed by the data, starting at offset
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include "markdown.h"
+
+//A single document in a bundle. The pointers refer to the memory of the bundle_reader it came from.
+struct bundle_entry {
+    const char *name;
+    size_t nameLength;
+    const char *data;
+    size_t length;
+};
+
+//A bundle opened for random access to its entries. The file is memory mapped where possible, so only the parts that are used are read. Otherwise it is read into contents.
+struct bundle_reader {
+    const char *data;
+    size_t size;
+    size_t count;
+    void *mapping;
+    std::vector<char> contents;
+};
+
+//A bundle being written. The number of entries is fixed when it is created so the index can be placed in front of the data.
+struct bundle_writer {
+    FILE *f;
+    size_t count;
+    size_t position;
+    std::vector<unsigned long long> index;
+    int failed;
+};
+
+//Each returns 0 on success and non-zero on failure.
+int OpenBundle(const char *fileName, bundle_reader *bundle);
+int GetBundleEntry(const bundle_reader *bundle, size_t n, bundle_entry *entry);
+void FreeBundle(bundle_reader *bundle);
+int CreateBundle(const char *fileName, size_t count, bundle_writer *bundle);
+int AddToBundle(bundle_writer *bundle, const char *name, size_t nameLength, const char *data, size_t length);
+int CloseBundle(bundle_writer *bundle);
+
+//Render every document of the input bundle into an output bundle of HTML pages in the same order, each named after its document with the extension replaced by .htm. Documents are rendered on the given number of threads (0 for one per core). Fails if any document fails to render, in which case no output bundle is left behind.
+int RenderBundle(const bundle_reader *input, const char *outputName, const markdown_options *options, int threads);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ Command line tool for creating and unpacking document bundles.
+ 
+ Usage: bundletool pack out.bundle [file1.md file2.md ...]
+        bundletool list in.bundle
+        bundletool extract in.bundle [name1 name2 ...]
+ 
+ pack stores the files under the names given. Without file arguments the names are read from stdin, one per line, which suits large archives (find docs -name '*.md' | bundletool pack docs.bundle). list prints the index. extract writes every entry to a file of the same name, or with names writes only those entries to stdout.
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include "bundle.h"
+
+int Pack(const char *bundleName, std::vector<std::string> &fileNames);
+int List(const char *bundleName);
+int Extract(const char *bundleName, int nameCount, const char *names[]);
+int IsSafeName(const std::string &name);
+
+int main(int argc, const char *argv[])
+{
+    if (argc>=3 && !strcmp(argv[1], "pack")) {
+        std::vector<std::string> fileNames(argv+3, argv+argc);
+        
+        //Without file arguments read the names from stdin.
+        if (fileNames.empty()) {
+            char line[4096];
+            
+            while (fgets(line, sizeof(line), stdin)) {
+                line[strcspn(line, "\r\n")] = '\0';
+                if (*line)
+                    fileNames.push_back(line);
+            }
+        }
+        return Pack(argv[2], fileNames);
+    }
+    if (argc==3 && !strcmp(argv[1], "list"))
+        return List(argv[2]);
+    if (argc>=3 && !strcmp(argv[1], "extract"))
+        return Extract(argv[2], argc-3, argv+3);
+    
+    std::cerr << "Usage: " << argv[0] << " pack out.bundle [file ...]\n";
+    std::cerr << "       " << argv[0] << " list in.bundle\n";
+    std::cerr << "       " << argv[0] << " extract in.bundle [name ...]\n";
+    return 1;
+}
+
+/*
+ Pack() writes the given files into a new bundle, each stored under its name as given.
+ */
+int Pack(const char *bundleName, std::vector<std::string> &fileNames)
+{
+    bundle_writer bundle;
+    std::vector<char> data;
+    char buffer[4096];
+    size_t bytesRead;
+    
+    if (CreateBundle(bundleName, fileNames.size(), &bundle)) {
+        std::cerr << "Error opening " << bundleName << " for writing\n";
+        return 1;
+    }
+    
+    for (size_t i=0; i<fileNames.size(); ++i) {
+        FILE *f = fopen(fileNames[i].c_str(), "rb");
+        
+        if (f==NULL) {
+            std::cerr << "Error opening " << fileNames[i] << " for reading\n";
+            CloseBundle(&bundle);
+            remove(bundleName);
+            return 1;
+        }
+        data.clear();
+        while ((bytesRead=fread(buffer, 1, sizeof(buffer), f))>0)
+            data.insert(data.end(), buffer, buffer+bytesRead);
+        fclose(f);
+        
+        AddToBundle(&bundle, fileNames[i].data(), fileNames[i].size(), data.empty()?"":&data[0], data.size());
+    }
+    
+    if (CloseBundle(&bundle)) {
+        std::cerr << "Error writing " << bundleName << "\n";
+        remove(bundleName);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ List() prints the number, size and name of every entry.
+ */
+int List(const char *bundleName)
+{
+    bundle_reader bundle;
+    bundle_entry entry;
+    
+    if (OpenBundle(bundleName, &bundle)) {
+        std::cerr << "Error reading bundle " << bundleName << "\n";
+        return 1;
+    }
+    for (size_t i=0; i<bundle.count; ++i) {
+        if (GetBundleEntry(&bundle, i, &entry)) {
+            std::cerr << "Entry " << i << " of " << bundleName << " is damaged\n";
+            FreeBundle(&bundle);
+            return 1;
+        }
+        std::cout << i << "\t" << entry.length << "\t" << std::string(entry.name, entry.nameLength) << "\n";
+    }
+    FreeBundle(&bundle);
+    return 0;
+}
+
+/*
+ Extract() writes the named entries to stdout, or every entry to a file of its own name when no names are given. Names that would leave the current directory are refused.
+ */
+int Extract(const char *bundleName, int nameCount, const char *names[])
+{
+    bundle_reader bundle;
+    bundle_entry entry;
+    int failed = 0;
+    
+    if (OpenBundle(bundleName, &bundle)) {
+        std::cerr << "Error reading bundle " << bundleName << "\n";
+        return 1;
+    }
+    
+    for (size_t i=0; i<bundle.count && !failed; ++i) {
+        std::string name;
+        
+        if (GetBundleEntry(&bundle, i, &entry)) {
+            std::cerr << "Entry " << i << " of " << bundleName << " is damaged\n";
+            failed = 1;
+            break;
+        }
+        name.assign(entry.name, entry.nameLength);
+        
+        if (nameCount) {
+            for (int j=0; j<nameCount; ++j) {
+                if (name==names[j] && fwrite(entry.data, 1, entry.length, stdout)!=entry.length)
+                    failed = 1;
+            }
+        }
+        else if (!IsSafeName(name)) {
+            std::cerr << "Refusing to extract \"" << name << "\"\n";
+            failed = 1;
+        }
+        else {
+            FILE *f = fopen(name.c_str(), "wb");
+            
+            if (f==NULL) {
+                std::cerr << "Error opening " << name << " for writing\n";
+                failed = 1;
+            }
+            else if ((fwrite(entry.data, 1, entry.length, f)!=entry.length) | fclose(f)) {
+                std::cerr << "Error writing " << name << "\n";
+                failed = 1;
+            }
+        }
+    }
+    
+    FreeBundle(&bundle);
+    return failed;
+}
+
+/*
+ IsSafeName() checks that an entry name is a relative path that does not climb out of the current directory.
+ */
+int IsSafeName(const std::string &name)
+{
+    if (name.empty() || name[0]=='/' || name.find('\0')!=std::string::npos)
+        return 0;
+    for (size_t start=0; start<=name.size(); ) {
+        size_t end = name.find('/', start);
+        
+        if (end==std::string::npos)
+            end = name.size();
+        if (name.compare(start, end-start, "..")==0)
+            return 0;
+        start = end+1;
+    }
+    return 1;
+}
@@ -0,0 +1,403 @@
+/*
+ Command line front end for the markdown parser. Reads the source file into memory and renders it with the library to a .htm file or to the console.
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "markdown.h"
+#include "bundle.h"
+
+int FileExists(const char *fileName);
+void RemoveExtension(std::string *s);
+int ConvertBundle(const char *bundleName, markdown_options *options, int noOverwrite);
+int ConvertVariants(const char *fileName, const std::vector<char> &source, int styleCount, const char *styleArguments[], const markdown_options *options, int noOverwrite, int toTerminal);
+std::string VariantFileName(const std::string &outputName, int outputFileModifier, int n);
+
+int main(int argc, const char *argv[])
+{
+    int verbose = 0;
+    int embeddedStyles = 0;
+    int noOverwrite = 0;
+    int toTerminal = 0;
+    int markup = markupInline;
+    int bundleMode = 0;
+    int themes = 0;
+    int maxBlocks = 0;
+    long maxBytes = 0;
+    int compress = 0, keepPlain = 0, compressLevel = -1;
+    int switchOffset = 1;
+    std::string outputName, outputFileName, gzFileName;
+    int outputFileModifier = 0;
+    FILE *outFile = NULL, *gzFile = NULL, *markdownFile;
+    char buffer[4096];
+    std::vector<char> source;
+    std::vector<const char *> styles;
+    markdown_options options = markdown_options();
+    size_t bytesRead;
+    int failed, closeFailed = 0;
+    double compressTime = 0, totalTime;
+    std::chrono::steady_clock::time_point start;
+    
+    //Search command for valid program arguments and handle them.
+    for (switchOffset=1; switchOffset<argc && argv[switchOffset][0]=='-'; ++switchOffset) {
+        //Limits for rendering only the start of the document are given as --blocks=N and --bytes=N.
+        if (!strncmp(argv[switchOffset], "--blocks=", 9)) {
+            maxBlocks = atoi(argv[switchOffset]+9);
+            continue;
+        }
+        if (!strncmp(argv[switchOffset], "--bytes=", 8)) {
+            maxBytes = atol(argv[switchOffset]+8);
+            continue;
+        }
+        for (int i=1; i<strlen(argv[switchOffset]); ++i) {
+            switch (argv[switchOffset][i]) {
+                case 'b':
+                    bundleMode = 1;
+                    break;
+                case 'c':
+                    markup = markupClass;
+                    break;
+                case 'e':
+                    embeddedStyles = 1;
+                    break;
+                case 'n':
+                    noOverwrite = 1;
+                    break;
+                case 'o':
+                    toTerminal = 1;
+                    break;
+                case 'p':
+                    keepPlain = 1;
+                    break;
+                case 's':
+                    markup = markupSemantic;
+                    break;
+                case 't':
+                    themes = 1;
+                    break;
+                case 'z':
+                    compress = 1;
+                    break;
+                case '0': case '1': case '2': case '3': case '4':
+                case '5': case '6': case '7': case '8': case '9':
+                    compressLevel = argv[switchOffset][i]-'0';
+                    break;
+                case 'v':;
+                    verbose = 1;
+                    break;
+                default:
+                    if (verbose)
+                        std::cerr << "Invalid switch \"" << argv[switchOffset][i] << "\"\n";
+                    break;
+            }
+        }
+    }
+    
+    //Check if there is at least a source file in the command, otherwise the command is not valid.
+    if (argc-switchOffset<1) {
+        std::cerr << "Too few arguments. Usage: " << argv[0] << " [-bcenopstvz0-9] [--blocks=N] [--bytes=N] fOut fIn [style1 style2 ...]\n";
+        return 1;
+    }
+    
+    //A bundle is always written to a .htm.bundle file, uncompressed, with every page rendered from its own head.
+    if (bundleMode && (compress || keepPlain || toTerminal || themes)) {
+        std::cerr << "The -z, -p, -o and -t switches cannot be used with -b\n";
+        return 1;
+    }
+    
+    //Themes write one plain page per set of stylesheets.
+    if (themes && (compress || keepPlain)) {
+        std::cerr << "The -z and -p switches cannot be used with -t\n";
+        return 1;
+    }
+    
+    //The rest of the arguments are stylesheet references, which are written out last to first.
+    for (int i=argc-1; i>switchOffset; --i)
+        styles.push_back(argv[i]);
+    
+    options.styles = styles.empty()?NULL:&styles[0];
+    options.styleCount = (int)styles.size();
+    options.embeddedStyles = embeddedStyles;
+    options.verbose = verbose;
+    options.markup = markup;
+    options.maxBlocks = maxBlocks>0?maxBlocks:0;
+    options.maxBytes = maxBytes>0?maxBytes:0;
+    
+    //In bundle mode the source is a bundle of documents, rendered into a bundle of pages.
+    if (bundleMode)
+        return ConvertBundle(argv[switchOffset], &options, noOverwrite);
+    
+    //Determine whether the source file exists.
+    if ((markdownFile=fopen(argv[switchOffset], "r"))==NULL) {
+        std::cerr << "Error opening " << argv[switchOffset] << " for reading\n";
+        return 1;
+    }
+    
+    //Read the whole source file into memory.
+    while ((bytesRead=fread(buffer, 1, sizeof(buffer), markdownFile))>0)
+        source.insert(source.end(), buffer, buffer+bytesRead);
+    fclose(markdownFile);
+    
+    //With themes the stylesheet arguments are several sets, each giving its own page.
+    if (themes)
+        return ConvertVariants(argv[switchOffset], source, argc-switchOffset-1, argv+switchOffset+1, &options, noOverwrite, toTerminal);
+    
+    //Determine whether the output is written to file or to the console (stdout).
+    if (toTerminal) {
+        //Point the output file to stdout, compressed or not.
+        if (compress)
+            gzFile = stdout;
+        else
+            outFile = stdout;
+    }
+    else {
+        //Copy the source filename from the command and remove the extenstion.
+        outputName = argv[switchOffset];
+        RemoveExtension(&outputName);
+        
+        //Append .htm (and .htm.gz) to the end.
+        outputFileName = outputName+".htm";
+        gzFileName = outputName+".htm.gz";
+        
+        //The plain file is written unless compressing, where it has to be asked for. Both files share the same offset.
+        keepPlain = !compress || keepPlain;
+        
+        // If no overwriting has been set, check whether any of the files to be written exist.
+        while (noOverwrite && ((keepPlain && FileExists(outputFileName.c_str())) || (compress && FileExists(gzFileName.c_str())))) {
+            //Increment offset variable.
+            ++outputFileModifier;
+            
+            //Add new offset to filenames.
+            outputFileName = outputName+"_"+std::to_string(outputFileModifier)+".htm";
+            gzFileName = outputName+"_"+std::to_string(outputFileModifier)+".htm.gz";
+        }
+        
+        //Do a final check to see if the files can be written to.
+        if (keepPlain && (outFile=fopen(outputFileName.c_str(), "w"))==NULL) {
+            std::cerr << "Error opening " << outputFileName << " for writing\n";
+            return 1;
+        }
+        if (compress && (gzFile=fopen(gzFileName.c_str(), "wb"))==NULL) {
+            std::cerr << "Error opening " << gzFileName << " for writing\n";
+            if (outFile)
+                fclose(outFile);
+            return 1;
+        }
+        
+        if (verbose) {
+            if (keepPlain)
+                std::cerr << "Writing to file \"" << outputFileName << "\" (" << (embeddedStyles?"Embedding stylesheets":"Linking to stylesheets") << ")\n";
+            if (compress)
+                std::cerr << "Writing to file \"" << gzFileName << "\" (" << (embeddedStyles?"Embedding stylesheets":"Linking to stylesheets") << ")\n";
+        }
+    }
+    
+    start = std::chrono::steady_clock::now();
+    if (compress)
+        failed = RenderToGzipFile(source.empty()?"":&source[0], source.size(), &options, gzFile, compressLevel, outFile, &compressTime);
+    else
+        failed = RenderToFile(source.empty()?"":&source[0], source.size(), &options, outFile);
+    totalTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    
+    //Timings go to stderr so that they never end up in a page written to stdout.
+    if (verbose) {
+        std::cerr << "Converted in " << totalTime*1000 << " ms";
+        if (compress)
+            std::cerr << " (compression " << compressTime*1000 << " ms)";
+        std::cerr << "\n";
+    }
+    
+    //Close the output files.
+    if (outFile && fclose(outFile))
+        closeFailed = 1;
+    if (gzFile && fclose(gzFile))
+        closeFailed = 1;
+    if (failed || closeFailed) {
+        std::cerr << "Error writing " << (toTerminal?std::string("to stdout"):compress?gzFileName:outputFileName) << "\n";
+        return 1;
+    }
+    
+    return 0;
+}
+
+/*
+ FileExists() checks whether a file exists by trying to open it for reading.
+ */
+int FileExists(const char *fileName)
+{
+    FILE *f = fopen(fileName, "r");
+    
+    if (f==NULL)
+        return 0;
+    fclose(f);
+    return 1;
+}
+
+/*
+ ConvertBundle() renders every document in a bundle into a .htm.bundle file next to it. Stylesheets to be embedded are read once up front rather than for every document.
+ */
+int ConvertBundle(const char *bundleName, markdown_options *options, int noOverwrite)
+{
+    std::string outputName = bundleName, outputFileName;
+    int outputFileModifier = 0, failed;
+    bundle_reader input;
+    std::vector<std::string> styleContents;
+    std::vector<int> styleLoaded;
+    std::vector<const char *> stylePointers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    if (OpenBundle(bundleName, &input)) {
+        std::cerr << "Error reading bundle " << bundleName << "\n";
+        return 1;
+    }
+    
+    if (options->embeddedStyles) {
+        for (int i=0; i<options->styleCount; ++i) {
+            FILE *fTMP = fopen(options->styles[i], "r");
+            char buffer[1024];
+            size_t bytesRead;
+            
+            styleContents.push_back(std::string());
+            styleLoaded.push_back(fTMP!=NULL);
+            if (fTMP) {
+                while ((bytesRead=fread(buffer, 1, sizeof(buffer), fTMP))>0)
+                    styleContents.back().append(buffer, bytesRead);
+                fclose(fTMP);
+            }
+            else if (options->verbose)
+                std::cerr << "File \"" << options->styles[i] << "\" does not exist\n";
+        }
+        //Stylesheets that do not exist are left out, as they are for a single page.
+        for (size_t i=0; i<styleContents.size(); ++i)
+            stylePointers.push_back(styleLoaded[i]?styleContents[i].c_str():NULL);
+        options->styleContents = stylePointers.empty()?NULL:&stylePointers[0];
+    }
+    
+    //Name the output after the bundle, following the same no overwriting rules as single files.
+    RemoveExtension(&outputName);
+    outputFileName = outputName+".htm.bundle";
+    while (noOverwrite && FileExists(outputFileName.c_str()))
+        outputFileName = outputName+"_"+std::to_string(++outputFileModifier)+".htm.bundle";
+    
+    if (options->verbose)
+        std::cerr << "Writing " << input.count << " pages to bundle \"" << outputFileName << "\"\n";
+    
+    failed = RenderBundle(&input, outputFileName.c_str(), options, 0);
+    FreeBundle(&input);
+    if (failed) {
+        std::cerr << "Error writing bundle " << outputFileName << "\n";
+        return 1;
+    }
+    
+    if (options->verbose)
+        std::cerr << "Converted in " << std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()*1000 << " ms\n";
+    return 0;
+}
+
+/*
+ ConvertVariants() writes one page per set of stylesheets, sharing a single render of the body. Sets are separated by "," arguments and a set starting with "-e" is embedded. Page i (counting from 1) is written to name.i.htm.
+ */
+int ConvertVariants(const char *fileName, const std::vector<char> &source, int styleCount, const char *styleArguments[], const markdown_options *options, int noOverwrite, int toTerminal)
+{
+    std::string outputName = fileName, outputFileName;
+    int outputFileModifier = 0, failed = 0, exists;
+    std::vector<std::vector<const char *> > sets(1);
+    std::vector<markdown_options> variants;
+    std::vector<int> embedded(1, options->embeddedStyles);
+    std::vector<FILE *> files;
+    
+    //Split the arguments into sets, each written out last to first like a single page's stylesheets.
+    for (int i=styleCount-1; i>=0; --i) {
+        if (!strcmp(styleArguments[i], ",")) {
+            sets.push_back(std::vector<const char *>());
+            embedded.push_back(options->embeddedStyles);
+        }
+        else if (!strcmp(styleArguments[i], "-e") && (i==0 || !strcmp(styleArguments[i-1], ",")))
+            embedded.back() = 1;
+        else
+            sets.back().push_back(styleArguments[i]);
+    }
+    
+    //The sets were collected from the last one, so put them back in command order.
+    for (int i=(int)sets.size()-1; i>=0; --i) {
+        markdown_options variant = *options;
+        variant.styles = sets[i].empty()?NULL:&sets[i][0];
+        variant.styleCount = (int)sets[i].size();
+        variant.embeddedStyles = embedded[i];
+        variants.push_back(variant);
+    }
+    
+    if (toTerminal)
+        files.assign(variants.size(), stdout);
+    else {
+        RemoveExtension(&outputName);
+        
+        // If no overwriting has been set, increase the offset until none of the pages exist.
+        exists = noOverwrite;
+        while (exists) {
+            exists = 0;
+            for (int i=0; i<(int)variants.size() && !exists; ++i) {
+                outputFileName = VariantFileName(outputName, outputFileModifier, i+1);
+                exists = FileExists(outputFileName.c_str());
+            }
+            if (exists)
+                ++outputFileModifier;
+        }
+        
+        for (int i=0; i<(int)variants.size(); ++i) {
+            outputFileName = VariantFileName(outputName, outputFileModifier, i+1);
+            
+            files.push_back(fopen(outputFileName.c_str(), "w"));
+            if (files.back()==NULL) {
+                std::cerr << "Error opening " << outputFileName << " for writing\n";
+                for (int j=0; j<i; ++j)
+                    fclose(files[j]);
+                return 1;
+            }
+            if (options->verbose)
+                std::cerr << "Writing to file \"" << outputFileName << "\" (" << (variants[i].embeddedStyles?"Embedding stylesheets":"Linking to stylesheets") << ")\n";
+        }
+    }
+    
+    failed = RenderVariantsToFiles(source.empty()?"":&source[0], source.size(), &variants[0], (int)variants.size(), &files[0]);
+    
+    //Close the output files.
+    if (!toTerminal) {
+        for (size_t i=0; i<files.size(); ++i)
+            if (fclose(files[i]))
+                failed = 1;
+    }
+    else if (fflush(stdout))
+        failed = 1;
+    
+    if (failed) {
+        std::cerr << "Error writing " << (toTerminal?"to stdout":outputName) << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+std::string VariantFileName(const std::string &outputName, int outputFileModifier, int n)
+{
+    if (outputFileModifier)
+        return outputName+"_"+std::to_string(outputFileModifier)+"."+std::to_string(n)+".htm";
+    return outputName+"."+std::to_string(n)+".htm";
+}
+
+/*
+ RemoveExtension() strips everything from the last '.' of a file name, for naming the output files.
+ */
+void RemoveExtension(std::string *s)
+{
+    size_t dot = s->rfind('.');
+    
+    if (dot!=std::string::npos)
+        s->erase(dot);
+}
@@ -6,134 +6,303 @@
 
 #include <iostream>
 #include <stack>
+#include <vector>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <cstdarg>
+#include <chrono>
+#include <zlib.h>
+#include "markdown.h"
+
+//Types used only inside the parser are kept out of the global namespace of programs linking the library.
+namespace {
 
 //Enumeration to siginify different HTML blocks (used in conjuntion with a stack)
 enum block_enum {
     blockNone=0x00, blockP, blockQuote, blockCode, blockPre, blockUl, blockOl, blockLi, blockH1=0x0A, blockH2, blockH3, blockH4, blockH5, blockH6, blockHtml=0x30, blockHead, blockBody, blockStyle
 };
 
-void Indent(void);
-int StripNL(char *s);
-int IsNumber(char c);
-int ResolveBlock(char *s);
-void WriteLine(char *s);
-void TerminateLine(void);
-int IsWhitespace(char c);
-int IsListElement(char *s, int *level, int *cutOff);
-int IsListBlock(block_enum block);
-void AddToBlockStack(block_enum block, char *customisation);
-void RemoveFromBlockStack(int n);
-void ClearBlocks(void);
-int LinkPresent(char *s, char *linkName, char *linkURL, int *offset);
-int SpanBlockPresent(char *s, char *styleClass, int *offset);
-void RemoveExtension(char *s);
-int IsHTMLCode(char *s, int *offset);
-void EscapeCharacter(char c);
-
-char const *tags[] = {"", "p", "blockquote", "code", "pre", "ul", "ol", "li", "", "", "h1", "h2", "h3", "h4", "h5", "h6"};
-char const *templateTags[] = {"html", "head", "body", "style"};
-int allowChanges = 0, listLevel = 0, indentOffset = 0;
-int verbose = 0;
-int openTag = 0, closeTag = 0, plainWrite = 0;
-FILE *outFile, *markdownFile;
+//Kinds of inline element, "$..$[" spans being the last.
+enum inline_enum {
+    inlineBold=0, inlineItalic, inlineBoldItalic, inlineStrike, inlineSpan
+};
+
+//An inline element open within a line, with the markup that opened it so that it can be reopened.
+struct inline_element {
+    int kind;
+    std::string open;
+};
+
+}
+
+static void Indent(void);
+static int StripNL(char *s);
+static int IsNumber(char c);
+static int ResolveBlock(char *s);
+static void WriteLine(char *s);
+static void TerminateLine(void);
+static int IsWhitespace(char c);
+static int IsListElement(char *s, int *level, int *cutOff);
+static int IsListBlock(block_enum block);
+static void AddToBlockStack(block_enum block, char *customisation);
+static void RemoveFromBlockStack(int n);
+static void ClearBlocks(void);
+static int LinkPresent(char *s, char *linkName, char *linkURL, int *offset);
+static int SpanBlockPresent(char *s, char *styleClass, int *offset);
+static int IsHTMLCode(char *s, int *offset);
+static void EscapeCharacter(char c);
+static int Render(const char *source, size_t length, const markdown_options *options);
+static int RenderVariants(const char *source, size_t length, const markdown_options *variants, int variantCount, FILE **files, std::string *buffers);
+static void StartDocument(const char *source, size_t length, const markdown_options *options);
+static void WriteHead(const markdown_options *options, char *line);
+static void WriteBody(char *line);
+static char *ReadLine(char *s, int size);
+static void Print(const char *format, ...);
+static void PutChar(char c);
+static void WriteOut(const char *data, size_t length);
+static void FlushOutput(void);
+static void Compress(const char *data, size_t length, int flush);
+static int LimitReached(void);
+static int StartTopLevelBlock(void);
+static void OpenInline(std::vector<inline_element> &elements, int kind, const char *open);
+static void CloseInline(std::vector<inline_element> &elements, int kind);
+
+static char const *tags[] = {"", "p", "blockquote", "code", "pre", "ul", "ol", "li", "", "", "h1", "h2", "h3", "h4", "h5", "h6"};
+static char const *templateTags[] = {"html", "head", "body", "style"};
+
+//Opening and closing markup for bold, italic, bold-italic and strikethrough text, indexed by markup_enum and inline_enum.
+static char const *inlineOpen[][4] = {
+    {"<span class=\"span-bold\" style=\"font-weight: bold\">", "<span class=\"span-italic\" style=\"font-style: italic\">", "<span class=\"span-bold span-italic\" style=\"font-weight: bold; font-style: italic\">", "<span class=\"span-strikethough\" style=\"text-decoration: line-through\">"},
+    {"<span class=\"span-bold\">", "<span class=\"span-italic\">", "<span class=\"span-bold span-italic\">", "<span class=\"span-strikethough\">"},
+    {"<strong>", "<em>", "<strong><em>", "<del>"}
+};
+static char const *inlineClose[][4] = {
+    {"</span>", "</span>", "</span>", "</span>"},
+    {"</span>", "</span>", "</span>", "</span>"},
+    {"</strong>", "</em>", "</em></strong>", "</del>"}
+};
+
+//Rules written once in the head for class-only markup, replacing the per-span style attributes.
+static char const *inlineClassRules[] = {
+    ".span-bold { font-weight: bold }\n",
+    ".span-italic { font-style: italic }\n",
+    ".span-strikethough { text-decoration: line-through }\n"
+};
+
+//Conversion state is kept per thread so that several documents can be rendered concurrently.
+static thread_local int allowChanges = 0, listLevel = 0, indentOffset = 0;
+static thread_local int verbose = 0;
+static thread_local int openTag = 0, closeTag = 0, plainWrite = 0;
+static thread_local int markup = markupInline;
+
+//Limits for rendering only the start of a document (zero for no limit), and whether rendering has been cut short.
+static thread_local int maxBlocks = 0, blockCount = 0, stopped = 0;
+static thread_local size_t maxBytes = 0, bodyStart = 0;
+
+namespace {
+
+//The source document being read, with fgets()-like end of file behaviour.
+struct input_source {
+    const char *data;
+    size_t length;
+    size_t position;
+    int eof;
+};
+
+//Where the HTML goes. Output is collected in chunk and handed to the destinations that are set when full. A gzip stream can be written alongside the plain file.
+struct output_sink {
+    FILE *file;
+    FILE *gzFile;
+    z_stream stream;
+    double compressTime;
+    std::string *buffer;
+    markdown_write_fn write;
+    void *userData;
+    char chunk[4096];
+    size_t used;
+    size_t written;
+    int failed;
+};
+
+}
+
+static thread_local input_source in;
+static thread_local output_sink out;
 
 //Create a HTML block hierarchy stack.
-std::stack<block_enum> blockStack;
+static thread_local std::stack<block_enum> blockStack;
 
-int main(int argc, const char *argv[])
+int RenderToFile(const char *source, size_t length, const markdown_options *options, FILE *f)
 {
-    char line[1024];
-    int trimStart = 0;
-    char *documentTitle = NULL;
-    int embeddedStyles = 0;
-    int noOverwrite = 0;
-    int toTerminal = 0;
-    int switchOffset = 1;
-    char outputName[64] = "", outputFileName[64] = "";
-    int outputFileModifier = 0;
-    
-    //Search command for valid program arguments and handle them.
-    for (switchOffset=1; switchOffset<argc && argv[switchOffset][0]=='-'; ++switchOffset) {
-        for (int i=1; i<strlen(argv[switchOffset]); ++i) {
-            switch (argv[switchOffset][i]) {
-                case 'e':
-                    embeddedStyles = 1;
-                    break;
-                case 'n':
-                    noOverwrite = 1;
-                    break;
-                case 'o':
-                    toTerminal = 1;
-                    break;
-                case 'v':;
-                    verbose = 1;
-                    break;
-                default:
-                    if (verbose)
-                        std::cerr << "Invalid switch \"" << argv[switchOffset][i] << "\"\n";
-                    break;
-            }
-        }
-    }
+    out.file = f;
+    out.gzFile = NULL;
+    out.buffer = NULL;
+    out.write = NULL;
+    return Render(source, length, options);
+}
+
+int RenderToBuffer(const char *source, size_t length, const markdown_options *options, std::string *buffer)
+{
+    out.file = NULL;
+    out.gzFile = NULL;
+    out.buffer = buffer;
+    out.write = NULL;
+    return Render(source, length, options);
+}
+
+int RenderToCallback(const char *source, size_t length, const markdown_options *options, markdown_write_fn write, void *userData)
+{
+    out.file = NULL;
+    out.gzFile = NULL;
+    out.buffer = NULL;
+    out.write = write;
+    out.userData = userData;
+    return Render(source, length, options);
+}
+
+int RenderToGzipFile(const char *source, size_t length, const markdown_options *options, FILE *gzFile, int level, FILE *f, double *compressTime)
+{
+    int failed;
     
-    //Check if there is at least a source file in the command, otherwise the command is not valid.
-    if (argc-switchOffset<1) {
-        std::cerr << "Too few arguments. Usage: " << argv[0] << " [-enov] fOut fIn [style1 style2 ...]\n";
-        return 1;
-    }
+    out.file = f;
+    out.gzFile = gzFile;
+    out.buffer = NULL;
+    out.write = NULL;
+    out.compressTime = 0;
     
-    //Determine whether the source file exists.
-    if ((markdownFile=fopen(argv[switchOffset], "r"))==NULL) {
-        std::cerr << "Error opening " << argv[switchOffset] << " for reading\n";
+    //Window bits of 15+16 makes zlib write a gzip header and trailer around the deflate stream.
+    memset(&out.stream, 0, sizeof(out.stream));
+    if (deflateInit2(&out.stream, level, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY)!=Z_OK)
         return 1;
-    }
     
-    //Determine whether the output is written to file or to the console (stdout).
-    if (toTerminal) {
-        //Point the output file to stdout.
-        outFile = stdout;
+    failed = Render(source, length, options);
+    
+    //Flush whatever deflate is still holding on to and write the gzip trailer.
+    if (!failed) {
+        Compress(NULL, 0, Z_FINISH);
+        failed = out.failed;
     }
-    else {
-        //Copy the source filename from the command and remove the extenstion.
-        strcpy(outputName, argv[switchOffset]);
-        RemoveExtension(outputName);
-        
-        //Append .htm to the end.
-        sprintf(outputFileName, "%s.htm", outputName);
-        
-        // If no overwriting has been set, check if the file file exists by tryin to open it.
-        while (noOverwrite && (outFile=fopen(outputFileName, "r"))!=NULL) {
-            //Increment offset variable, close file.
-            ++outputFileModifier;
-            fclose(outFile);
-            
-            //Add new offset to filename.
-            sprintf(outputFileName, "%s_%d.htm", outputName, outputFileModifier);
-        }
+    deflateEnd(&out.stream);
+    
+    if (compressTime)
+        *compressTime = out.compressTime;
+    return failed;
+}
+
+int RenderVariantsToFiles(const char *source, size_t length, const markdown_options *variants, int variantCount, FILE **files)
+{
+    return RenderVariants(source, length, variants, variantCount, files, NULL);
+}
+
+int RenderVariantsToBuffers(const char *source, size_t length, const markdown_options *variants, int variantCount, std::string *buffers)
+{
+    return RenderVariants(source, length, variants, variantCount, NULL, buffers);
+}
+
+/*
+ Render() converts a whole document to HTML, writing it to whichever output has been set up by the caller.
+ */
+int Render(const char *source, size_t length, const markdown_options *options)
+{
+    char line[1024] = "";
+    
+    StartDocument(source, length, options);
+    WriteHead(options, line);
+    WriteBody(line);
+    
+    FlushOutput();
+    return out.failed;
+}
+
+/*
+ RenderVariants() renders the body of a document once and then writes one page per variant, each with its own head followed by the shared body. Output goes to files[i] or buffers[i].
+ */
+int RenderVariants(const char *source, size_t length, const markdown_options *variants, int variantCount, FILE **files, std::string *buffers)
+{
+    char line[1024] = "";
+    std::string body;
+    size_t headLength;
+    markdown_options first;
+    int failed = 0;
+    
+    if (variantCount<1)
+        return 0;
+    
+    //Render the whole document with the first variant into memory and keep only the part after the head. Its head is written again below, so it is not reported here.
+    first = variants[0];
+    first.verbose = 0;
+    out.file = NULL;
+    out.gzFile = NULL;
+    out.buffer = &body;
+    out.write = NULL;
+    StartDocument(source, length, &first);
+    WriteHead(&first, line);
+    FlushOutput();
+    headLength = body.size();
+    WriteBody(line);
+    FlushOutput();
+    body.erase(0, headLength);
+    
+    for (int i=0; i<variantCount; ++i) {
+        markdown_options variant = variants[i];
         
-        //Do a final check to see if the file can be written to.
-        if ((outFile=fopen(outputFileName, "w"))==NULL) {
-            std::cerr << "Error opening " << outputFileName << " for writing\n";
-            fclose(markdownFile);
-            return 1;
-        }
+        //The body has already been rendered, so anything that affects it comes from the first variant.
+        variant.markup = variants[0].markup;
+        variant.maxBlocks = variants[0].maxBlocks;
+        variant.maxBytes = variants[0].maxBytes;
         
-        if (verbose) {
-            std::cout << "Writing to file \"" << outputFileName << "\" (" << (embeddedStyles?"Embedding stylesheets":"Linking to stylesheets") << ")\n";
-        }
+        out.file = files?files[i]:NULL;
+        out.buffer = buffers?&buffers[i]:NULL;
+        line[0] = '\0';
+        StartDocument(source, length, &variant);
+        WriteHead(&variant, line);
+        FlushOutput();
+        WriteOut(body.data(), body.size());
+        failed |= out.failed;
     }
+    return failed;
+}
+
+/*
+ StartDocument() points the input at a new document and resets the state left over from any previous one.
+ */
+void StartDocument(const char *source, size_t length, const markdown_options *options)
+{
+    in.data = source;
+    in.length = length;
+    in.position = 0;
+    in.eof = 0;
+    out.used = 0;
+    out.written = 0;
+    out.failed = 0;
+    allowChanges = listLevel = indentOffset = 0;
+    openTag = closeTag = plainWrite = 0;
+    verbose = options->verbose;
+    markup = options->markup;
+    maxBlocks = options->maxBlocks;
+    maxBytes = options->maxBytes;
+    blockCount = stopped = 0;
+    while (!blockStack.empty())
+        blockStack.pop();
+}
+
+/*
+ WriteHead() writes everything up to the body: the doctype, title, stylesheets and the custom head code between "@$" and "$@". It leaves the first line of the body in line.
+ */
+void WriteHead(const markdown_options *options, char *line)
+{
+    char *documentTitle = NULL;
     
     //Write out header of HTML file.
-    fprintf(outFile, "<!DOCTYPE html>\n");
+    Print("<!DOCTYPE html>\n");
     
     //Add HTML and head blocks to the stack.
     AddToBlockStack(blockHtml, NULL);
     AddToBlockStack(blockHead, NULL);
     
     //Read in first line of source file.
-    fgets(line, 1024, markdownFile);
+    ReadLine(line, 1024);
     
     //If this line starts with "@@" treat it as defining the title of the HTML page.
     if (!strncmp(line, "@@ ", 3)) {
@@ -143,13 +312,38 @@ int main(int argc, const char *argv[])
     
     //Write out the title of the page.
     Indent();
-    fprintf(outFile, "<title>%s</title>\n", documentTitle!=NULL?documentTitle:"Untitled");
+    Print("<title>%s</title>\n", documentTitle!=NULL?documentTitle:options->title!=NULL?options->title:"Untitled");
     
-    //The reset of the arguments are stylesheet references, loop though theses.
-    for (int i=argc-1; i>switchOffset; --i) {
+    //With class-only markup the styling of bold, italic and strikethrough spans is defined once here, ahead of the stylesheets so that they can override it.
+    if (markup==markupClass) {
+        AddToBlockStack(blockStyle, NULL);
+        for (int i=0; i<(int)(sizeof(inlineClassRules)/sizeof(*inlineClassRules)); ++i) {
+            Indent();
+            Print("%s", inlineClassRules[i]);
+        }
+        RemoveFromBlockStack(1);
+    }
+    
+    //Loop through the stylesheet references.
+    for (int i=0; i<options->styleCount; ++i) {
+        //If the caller has already read the stylesheet, copy it line by line to the HTML page. A NULL entry is a stylesheet that could not be read and is skipped.
+        if (options->embeddedStyles && options->styleContents) {
+            const char *p = options->styleContents[i], *q;
+            
+            if (p==NULL)
+                continue;
+            AddToBlockStack(blockStyle, NULL);
+            for (; *p; p=q) {
+                q = strchr(p, '\n');
+                q = q!=NULL?q+1:p+strlen(p);
+                Indent();
+                Print("%.*s", (int)(q-p), p);
+            }
+            RemoveFromBlockStack(1);
+        }
         //If embedded stylesheet are wanted, copy the file contents to the HTML page.
-        if (embeddedStyles) {
-            FILE *fTMP = fopen(argv[i], "r");
+        else if (options->embeddedStyles) {
+            FILE *fTMP = fopen(options->styles[i], "r");
             if (fTMP) {
                 char buffer[1024];
                 
@@ -159,25 +353,26 @@ int main(int argc, const char *argv[])
                 //Read content and write it out (indented) to the HTML page.
                 while (fgets(buffer, sizeof(buffer), fTMP)) {
                     Indent();
-                    fprintf(outFile, "%s", buffer);
+                    Print("%s", buffer);
                 }
+                fclose(fTMP);
                 
                 //Remove style block from stack.
                 RemoveFromBlockStack(1);
                 
                 if (verbose)
-                    std::cout << "Embedded \"" << argv[i] << "\"\n";
+                    std::cerr << "Embedded \"" << options->styles[i] << "\"\n";
             }
             else if (verbose)
-                std::cout << "File \"" << argv[i] << "\" does not exist\n";
+                std::cerr << "File \"" << options->styles[i] << "\" does not exist\n";
         }
         else {
             //Simply create a link reference to the stylesheet.
             Indent();
-            fprintf(outFile, "<link rel=\"stylesheet\" href=\"%s\" type=\"text/css\" />\n", argv[i]);
+            Print("<link rel=\"stylesheet\" href=\"%s\" type=\"text/css\" />\n", options->styles[i]);
             
             if (verbose) {
-                std::cout << "Linked to stylesheet located at \"" << argv[i] << "\"\n";
+                std::cerr << "Linked to stylesheet located at \"" << options->styles[i] << "\"\n";
             }
         }
     }
@@ -185,25 +380,36 @@ int main(int argc, const char *argv[])
     
     //If the first line of the souce file defined the title of the HTML page, get the next line.
     if (documentTitle)
-        fgets(line, 1024, markdownFile);
+        ReadLine(line, 1024);
     
     
     //If this line starts with "@$" treat it as defining the the start of the custom head HTML code.
     if (!strcmp(line, "@$\n")) {
         //Print contents of between "@$" and "$@" lines of the source file under this style block.
-        fgets(line, 1024, markdownFile);
-        while (strcmp(line, "$@\n")) {
+        while (ReadLine(line, 1024) && strcmp(line, "$@\n")) {
              Indent();
-             fprintf(outFile, "%s", line);
-             fgets(line, 1024, markdownFile);
+             Print("%s", line);
         }
         
         //Get the next line from source file.
-        fgets(line, 1024, markdownFile);
+        ReadLine(line, 1024);
     }
     
-    //Remove head block from stack and add body block to stack.
+    //Remove head block from stack.
     RemoveFromBlockStack(1);
+}
+
+/*
+ WriteBody() writes the body of the page, starting with the given line, and closes the page.
+ */
+void WriteBody(char *line)
+{
+    int trimStart = 0;
+    
+    //The byte limit applies to the body only, so it does not depend on the length of the head.
+    bodyStart = out.written+out.used;
+    
+    //Add body block to stack.
     AddToBlockStack(blockBody, NULL);
     
     //Start writing out the body/rest of the HTML page.
@@ -213,34 +419,157 @@ int main(int argc, const char *argv[])
             allowChanges = 0;
             ResolveBlock(line);
             WriteLine(line);
-            fprintf(outFile, "\n");
+            Print("\n");
             continue;
         }
         allowChanges = 1;
         trimStart = ResolveBlock(line);
+        
+        //The line would have started a block beyond the limit, so the document ends here.
+        if (stopped)
+            break;
         if (trimStart>=0) {
             Indent();
             WriteLine(line+trimStart);
             TerminateLine();
         }
-    } while (fgets(line, 1024, markdownFile));
+    } while (!LimitReached() && ReadLine(line, 1024));
     
-    //Remove any remaining blocks from stack.
+    //Remove any remaining blocks from stack, indented as blocks rather than as the last raw HTML line.
+    openTag = closeTag = plainWrite = 0;
     RemoveFromBlockStack((int)blockStack.size());
+}
+
+/*
+ ReadLine() behaves like fgets() on the source document: it reads up to size-1 characters, stopping after a newline, and returns NULL when nothing is left. The eof flag is raised when the read ran into the end of the document.
+ */
+char *ReadLine(char *s, int size)
+{
+    size_t n = in.length-in.position;
+    const char *nl;
+    
+    if (n==0) {
+        in.eof = 1;
+        return NULL;
+    }
+    if (n>(size_t)size-1)
+        n = size-1;
     
-    //Close the files used.
-    fclose(outFile);
-    fclose(markdownFile);
+    if ((nl=(const char *)memchr(in.data+in.position, '\n', n))!=NULL)
+        n = nl-(in.data+in.position)+1;
+    else if (in.length-in.position<(size_t)size-1)
+        in.eof = 1;
     
-    return 0;
+    memcpy(s, in.data+in.position, n);
+    s[n] = '\0';
+    in.position += n;
+    return s;
+}
+
+/*
+ Print() writes formatted text to the output, going through the chunk buffer.
+ */
+void Print(const char *format, ...)
+{
+    va_list args;
+    size_t space = sizeof(out.chunk)-out.used;
+    int n;
+    
+    va_start(args, format);
+    n = vsnprintf(out.chunk+out.used, space, format, args);
+    va_end(args);
+    
+    if (n<0)
+        return;
+    if ((size_t)n<space) {
+        out.used += n;
+        return;
+    }
+    
+    //The text did not fit in the rest of the chunk, so flush and format it again.
+    FlushOutput();
+    va_start(args, format);
+    if ((size_t)n<sizeof(out.chunk)) {
+        vsnprintf(out.chunk, sizeof(out.chunk), format, args);
+        out.used = n;
+    }
+    else {
+        char *large = (char *)malloc(n+1);
+        if (large) {
+            vsnprintf(large, n+1, format, args);
+            WriteOut(large, n);
+            free(large);
+        }
+        else
+            out.failed = 1;
+    }
+    va_end(args);
+}
+
+void PutChar(char c)
+{
+    if (out.used==sizeof(out.chunk))
+        FlushOutput();
+    out.chunk[out.used++] = c;
 }
+
+/*
+ WriteOut() hands a block of finished output to the destination set up for this conversion.
+ */
+void WriteOut(const char *data, size_t length)
+{
+    out.written += length;
+    if (out.failed || !length)
+        return;
+    if (out.file && fwrite(data, 1, length, out.file)!=length)
+        out.failed = 1;
+    if (out.gzFile)
+        Compress(data, length, Z_NO_FLUSH);
+    if (out.buffer)
+        out.buffer->append(data, length);
+    if (out.write && out.write(data, length, out.userData))
+        out.failed = 1;
+}
+
+void FlushOutput(void)
+{
+    WriteOut(out.chunk, out.used);
+    out.used = 0;
+}
+
 /*
- Indent() writed out indentation (using tab characters) to the file "outFile" dependent on how mant block are in the stack and takes in accound indentation for raw HTML that has been added.
+ StartTopLevelBlock() counts a block written directly into the body against the block limit. When the limit has already been reached it stops the render and returns 0.
+ */
+int StartTopLevelBlock(void)
+{
+    if (stopped)
+        return 0;
+    if (maxBlocks) {
+        if (blockCount==maxBlocks) {
+            stopped = 1;
+            return 0;
+        }
+        ++blockCount;
+    }
+    return 1;
+}
+
+/*
+ LimitReached() checks whether a partial render should stop, either because of the block limit or because the body has grown to the byte limit. The byte limit is checked between lines, so the output overshoots it by up to a line plus the closing tags. Raw HTML is not closed by the parser, so the render only stops outside of it.
+ */
+int LimitReached(void)
+{
+    if (maxBytes && !indentOffset && out.written+out.used-bodyStart>=maxBytes)
+        stopped = 1;
+    return stopped;
+}
+/*
+ Indent() writed out indentation (using tab characters) to the output dependent on how mant block are in the stack and takes in accound indentation for raw HTML that has been added.
  */
 void Indent(void)
 {
     for (int i=0; i<(int)blockStack.size()+indentOffset-openTag; ++i)
-        fprintf(outFile, "    ");
+        Print("    ");
 }
 
 /*
@@ -284,8 +613,12 @@ int ResolveBlock(char *s)
         case 1:
             if (allowChanges) {
                 ClearBlocks();
-                ++indentOffset;
                 allowChanges = 0;
+                
+                //Raw HTML opened outside of any other raw HTML counts as a top-level block.
+                if (!indentOffset && !StartTopLevelBlock())
+                    return modifier;
+                ++indentOffset;
             }
             openTag = 1;
             return modifier;
@@ -302,11 +635,17 @@ int ResolveBlock(char *s)
             if (allowChanges) {
                 ClearBlocks();
                 allowChanges = 0;
+                
+                //As does a plain line outside of raw HTML.
+                if (!indentOffset && !StartTopLevelBlock())
+                    return modifier;
             }
             plainWrite = 1;
             return modifier;
         default:
             if (indentOffset) {
+                //Like the other raw HTML lines this ends the changes for the line, so looking ahead to the next line cannot close the raw HTML early.
+                allowChanges = 0;
                 plainWrite = 1;
                 return modifier;
             }
@@ -455,6 +794,7 @@ void WriteLine(char *s)
     char data256[256] = "", data1024[1024] = "";
     char line[1024];
     int offset;
+    std::vector<inline_element> elements;
     
     strcpy(line, s);
     
@@ -468,7 +808,7 @@ void WriteLine(char *s)
             continue;
         }
         if (openTag || closeTag || plainWrite) {
-            fprintf(outFile, "%s", line);
+            Print("%s", line);
             continue;
         }
         
@@ -479,80 +819,83 @@ void WriteLine(char *s)
                             if (i+1<strlen(line) && strchr("<>&", line[i+1]))
                                 EscapeCharacter(line[++i]);
                             else
-                                fputc(line[i], outFile);
+                                PutChar(line[i]);
                         break;
                     case ' ':
                         if (!strncmp(line+i, "    ", 4)) {
-                            fprintf(outFile, "&emsp;");
+                            Print("&emsp;");
                             i += 3;
                         }
                         else
-                            fputc(line[i], outFile);
+                            PutChar(line[i]);
                         break;
                     case '`':
-                        fprintf(outFile, "<%scode%s>", isCode?"/":"", isCode?"":" class=\"code-inline\"");
+                        Print("<%scode%s>", isCode?"/":"", isCode?"":" class=\"code-inline\"");
                         isCode = !isCode;
                         break;
                     case '_':
                         if (!strncmp(line+i, "_**", 3) && !isBL) {
-                            fprintf(outFile, "<span class=\"span-bold span-italic\" style=\"font-weight: bold; font-style: italic\">");
+                            OpenInline(elements, inlineBoldItalic, inlineOpen[markup][inlineBoldItalic]);
                             i += 2;
                             isBL = 1;
                         }
                         break;
                     case '*':
                         if (!strncmp(line+i, "**_", 3) && isBL) {
-                            fprintf(outFile, "</span>");
+                            CloseInline(elements, inlineBoldItalic);
                             i += 2;
                             isBL = 0;
                         }
                         else if (i+1<strlen(line) && line[i+1]=='*') {
                             if (isBold)
-                                fprintf(outFile, "</span>");
+                                CloseInline(elements, inlineBold);
                             else
-                                fprintf(outFile, "<span class=\"span-bold\" style=\"font-weight: bold\">");
+                                OpenInline(elements, inlineBold, inlineOpen[markup][inlineBold]);
                             isBold = !isBold;
                             ++i;
                         }
                         else {
                             if (isItalic)
-                                fprintf(outFile, "</span>");
+                                CloseInline(elements, inlineItalic);
                             else
-                                fprintf(outFile, "<span class=\"span-italic\" style=\"font-style: italic\">");
+                                OpenInline(elements, inlineItalic, inlineOpen[markup][inlineItalic]);
                             isItalic = !isItalic;
                         }
                         break;
                     case '~':
                         if (i+1<strlen(line) && line[i+1]=='~') {
                             if (isStrike)
-                                fprintf(outFile, "</span>");
+                                CloseInline(elements, inlineStrike);
                             else
-                                fprintf(outFile, "<span class=\"span-strikethough\" style=\"text-decoration: line-through\">");
+                                OpenInline(elements, inlineStrike, inlineOpen[markup][inlineStrike]);
                             isStrike = !isStrike;
                             ++i;
                         }
                         break;
                     case ']':
                         if (spanCount) {
-                            fprintf(outFile, "</span>");
+                            CloseInline(elements, inlineSpan);
                             --spanCount;
                         }
                         else
-                            fputc(line[i], outFile);
+                            PutChar(line[i]);
                         break;
                     case '$':
                         if (SpanBlockPresent(line+i, data1024, &offset)) {
+                            std::string open;
+                            
                             if (!strlen(data1024))
-                                fprintf(outFile, "<span>");
+                                open = "<span>";
                             else if (*data1024=='^')
-                                fprintf(outFile, "<span style=\"%s\">", data1024+1);
+                                open = std::string("<span style=\"")+(data1024+1)+"\">";
                             else
-                                fprintf(outFile, "<span class=\"%s\">", data1024);
+                                open = std::string("<span class=\"")+data1024+"\">";
+                            OpenInline(elements, inlineSpan, open.c_str());
                             i += offset;
                             ++spanCount;
                         }
                         else {
-                            fputc(line[i], outFile);
+                            PutChar(line[i]);
                         }
                         break;
                     case '!':
@@ -563,24 +906,24 @@ void WriteLine(char *s)
                                 sprintf(formatting, " title=\"%s\" alt=\"%s\"", data256, data256);
                             else
                                 strcpy(formatting, "");
-                            fprintf(outFile, "<img src=\"%s\"%s />", data1024, formatting);
+                            Print("<img src=\"%s\"%s />", data1024, formatting);
                             i += offset+1;
                         }
                         else {
-                            fputc(line[i], outFile);
+                            PutChar(line[i]);
                         }
                         break;
                     case '[':
                         if (LinkPresent(line+i, data256, data1024, &offset) && strlen(data1024)) {
-                            fprintf(outFile, "<a href=\"%s\">%s</a>", data1024, data256);
+                            Print("<a href=\"%s\">%s</a>", data1024, data256);
                             i += offset+1;
                         }
                         else {
-                            fputc(line[i], outFile);
+                            PutChar(line[i]);
                         }
                         break;
                     default:
-                        fputc(line[i], outFile);
+                        PutChar(line[i]);
                         break;
                 }
             }
@@ -588,50 +931,85 @@ void WriteLine(char *s)
                 EscapeCharacter(line[i]);
             }
         }
-    } while (!newLineExists && fgets(line, 1024, markdownFile));
+    } while (!newLineExists && !LimitReached() && ReadLine(line, 1024));
     
     if (isCode)
-        fprintf(outFile, "</code>");
+        Print("</code>");
+    
+    //Close anything left open at the end of the line, innermost first.
+    while (!elements.empty())
+        CloseInline(elements, elements.back().kind);
+}
+
+/*
+ OpenInline() writes the opening markup of an inline element and records it as the innermost open element.
+ */
+void OpenInline(std::vector<inline_element> &elements, int kind, const char *open)
+{
+    inline_element element;
     
-    for (int i=0; i<isBold+isItalic+isBL+isStrike+spanCount; ++i)
-        fprintf(outFile, "</span>");
+    element.kind = kind;
+    element.open = open;
+    elements.push_back(element);
+    Print("%s", open);
+}
+
+/*
+ CloseInline() closes the innermost open element of the given kind. Elements opened after it are closed first and then reopened, so the tags stay properly nested.
+ */
+void CloseInline(std::vector<inline_element> &elements, int kind)
+{
+    int n = (int)elements.size()-1;
+    
+    while (n>=0 && elements[n].kind!=kind)
+        --n;
+    if (n<0)
+        return;
+    
+    for (int i=(int)elements.size()-1; i>=n; --i)
+        Print("%s", elements[i].kind==inlineSpan?"</span>":inlineClose[markup][elements[i].kind]);
+    for (int i=n+1; i<(int)elements.size(); ++i)
+        Print("%s", elements[i].open.c_str());
+    elements.erase(elements.begin()+n);
 }
 
 void TerminateLine(void)
 {
     char nextLine[16];
     int nextStart;
-    fpos_t cursor;
+    size_t cursor;
     
-    fgetpos(markdownFile, &cursor);
+    cursor = in.position;
     
-    fgets(nextLine, 16, markdownFile);
+    ReadLine(nextLine, 16);
     
-    if (feof(markdownFile)) {
-        fprintf(outFile, "\n");
+    //The next line is not rendered if the document ends or the render stops here.
+    if (in.eof || LimitReached()) {
+        Print("\n");
     }
     else {
         nextStart = ResolveBlock(nextLine);
         if (openTag || closeTag || plainWrite) {
-            fprintf(outFile, "\n");
+            Print("\n");
         }
         else if (blockStack.top()==blockP) {
             if (nextStart==0)
-                fprintf(outFile, "<br />\n");
+                Print("<br />\n");
             else
-                fprintf(outFile, "\n");
+                Print("\n");
         }
         else if (blockStack.top()==blockQuote) {
             if (nextLine[0]=='>')
-                fprintf(outFile, "<br />\n");
+                Print("<br />\n");
             else
-                fprintf(outFile, "\n");
+                Print("\n");
         }
         else {
-            fprintf(outFile, "\n");
+            Print("\n");
         }
     }
-    fsetpos(markdownFile, &cursor);
+    in.position = cursor;
+    in.eof = 0;
 }
 
 /*
@@ -681,8 +1059,14 @@ int IsListBlock(block_enum block)
 
 void AddToBlockStack(block_enum block, char *customisation)
 {
+    //Once the limit of top-level blocks is reached no further blocks are opened.
+    if (stopped)
+        return;
+    if (!blockStack.empty() && blockStack.top()==blockBody && !StartTopLevelBlock())
+        return;
+    
     Indent();
-    fprintf(outFile, "%s<%s%s>\n", block==blockCode?"<pre>":"", block>=0x30?templateTags[block&0x0F]:tags[block], customisation?customisation:"");
+    Print("%s<%s%s>\n", block==blockCode?"<pre>":"", block>=0x30?templateTags[block&0x0F]:tags[block], customisation?customisation:"");
     blockStack.push(block);
 }
 
@@ -695,7 +1079,7 @@ void RemoveFromBlockStack(int n)
         
         blockStack.pop();
         Indent();
-        fprintf(outFile, "</%s>%s\n", block>=0x30?templateTags[block&0x0F]:tags[block], block==blockCode?"</pre>":"");
+        Print("</%s>%s\n", block>=0x30?templateTags[block&0x0F]:tags[block], block==blockCode?"</pre>":"");
     }
 }
 
@@ -738,16 +1122,6 @@ int SpanBlockPresent(char *s, char *styleClass, int *offset)
     return 0;
 }
 
-void RemoveExtension(char *s)
-{
-    for (int i=(int)strlen(s)-1; i>=0; --i) {
-        if (s[i]=='.') {
-            s[i] = '\0';
-            break;
-        }
-    }
-}
-
 int IsHTMLCode(char *s, int *offset)
 {
     int firstNonSpace = 0;
@@ -772,16 +1146,49 @@ void EscapeCharacter(char c)
 {
     switch (c) {
         case '<':
-            fprintf(outFile, "&lt;");
+            Print("&lt;");
             break;
         case '>':
-            fprintf(outFile, "&gt;");
+            Print("&gt;");
             break;
         case '&':
-            fprintf(outFile, "&amp;");
+            Print("&amp;");
             break;
         default:
-            fputc(c, outFile);
+            PutChar(c);
             break;
     }
+}
+
+/*
+ Compress() runs a block of output through deflate and writes the compressed data to the gzip file as it is produced. Only the time spent in deflate is added to compressTime.
+ */
+void Compress(const char *data, size_t length, int flush)
+{
+    unsigned char buffer[16384];
+    size_t have;
+    int status;
+    std::chrono::steady_clock::time_point start;
+    
+    out.stream.next_in = (Bytef *)data;
+    out.stream.avail_in = (uInt)length;
+    
+    do {
+        out.stream.next_out = buffer;
+        out.stream.avail_out = sizeof(buffer);
+        
+        start = std::chrono::steady_clock::now();
+        status = deflate(&out.stream, flush);
+        out.compressTime += std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        
+        if (status==Z_STREAM_ERROR) {
+            out.failed = 1;
+            return;
+        }
+        have = sizeof(buffer)-out.stream.avail_out;
+        if (have && fwrite(buffer, 1, have, out.gzFile)!=have) {
+            out.failed = 1;
+            return;
+        }
+    } while (out.stream.avail_out==0);
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+/*
+ markdown.h declares the library interface of the markdown parser. A document is converted straight from a memory buffer (which is never copied or modified) into either a FILE, a caller-provided growable buffer or a chunked write callback.
+ 
+ Author: Kevin Hira, http://github.com/Kevos
+ */
+
+#ifndef MARKDOWN_H
+#define MARKDOWN_H
+
+#include <cstdio>
+#include <cstddef>
+#include <string>
+
+//How bold, italic and strikethrough text is marked up: spans with inline styles, spans with classes only (the rules are written once in the head), or <strong>/<em>/<del>.
+enum markup_enum {
+    markupInline=0, markupClass, markupSemantic
+};
+
+//Options controlling how a document is rendered. Zero-initialise and fill in the wanted fields.
+struct markdown_options {
+    const char *title;              //Title used when the source does not define one with "@@" (NULL for "Untitled").
+    const char * const *styles;     //Stylesheets, written out in the order given.
+    int styleCount;
+    int embeddedStyles;             //Non-zero to copy the stylesheet files into the page instead of linking to them.
+    const char * const *styleContents;  //If not NULL, the already loaded text of each stylesheet, embedded instead of reading the files. NULL entries are skipped.
+    int verbose;                    //Non-zero to report linked/embedded stylesheets on stderr, so a page written to stdout is never mixed with them.
+    int markup;                     //One of markup_enum, markupInline by default.
+    int maxBlocks;                  //If non-zero, stop after this many top-level blocks.
+    size_t maxBytes;                //If non-zero, stop once about this many bytes of the body have been written.
+};
+
+//Chunked write callback. Returns non-zero on failure, after which no more output is written.
+typedef int (*markdown_write_fn)(const char *data, size_t length, void *userData);
+
+//Render the markdown source of the given length. Each returns 0 on success and non-zero if writing the output failed.
+int RenderToFile(const char *source, size_t length, const markdown_options *options, FILE *f);
+int RenderToBuffer(const char *source, size_t length, const markdown_options *options, std::string *buffer);
+int RenderToCallback(const char *source, size_t length, const markdown_options *options, markdown_write_fn write, void *userData);
+
+//Render straight into a gzip compressed FILE with the given zlib level (0-9, or -1 for the default). If f is not NULL the plain HTML is written to it as well. The seconds spent compressing are stored in compressTime when it is not NULL.
+int RenderToGzipFile(const char *source, size_t length, const markdown_options *options, FILE *gzFile, int level, FILE *f, double *compressTime);
+
+//Render one document into a page per variant, e.g. per theme. The body is rendered once and shared, only the head (title, stylesheets, "@$" block) is written per variant, so options that affect the body (markup and the preview limits) are taken from the first variant. Page i is written to files[i] or buffers[i].
+int RenderVariantsToFiles(const char *source, size_t length, const markdown_options *variants, int variantCount, FILE **files);
+int RenderVariantsToBuffers(const char *source, size_t length, const markdown_options *variants, int variantCount, std::string *buffers);
+
+#endif